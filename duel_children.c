@@ -12,17 +12,34 @@
  *  both of then achieve 100 same values. at which point the parent
  *  declares the winner and terminates both child processes.
  *
- * Input: An integer that represents the seed.
+ * Optionally, the channels can wait for data in one of three policies:
+ *  block (the default read), spin (busy-poll the pipe) or hybrid (a
+ *  bounded spin followed by a blocking wait), and the parent and the
+ *  children can be pinned to chosen CPUs.
  *
- * Output: The winner (if there is one), and the children summary.
+ * Input: An integer that represents the seed, and optionally the
+ *  waiting policy and three CPU numbers (dad, first son, second son).
+ *
+ * Output: The winner (if there is one), the children summary and the
+ *  latency and CPU usage of the chosen policy.
  */
 
  //-------------- include section ---------------------------------------
 
+#define _GNU_SOURCE // for sched_setaffinity()
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
+#include <sys/resource.h>
 #include <unistd.h>
 #include <stdbool.h>
 
@@ -33,6 +50,15 @@ const int LOWER = -1;
 const int WON = 120;
 const int FINISED = 100;
 const int DIVIDE = 10;
+const int SPIN_LIMIT = 1000;
+const int NO_CPU = -1;
+const int CORRECTION_NUMBER = 1000000;
+const int NANO_IN_MICRO = 1000;
+
+enum wait_policy { BLOCK, SPIN, HYBRID };
+const char* POLICY_NAMES[] = { "block", "spin", "hybrid" };
+const char* USAGE = "Usage: duel_children <seed> [block|spin|hybrid] "
+    "[dad cpu] [first son cpu] [second son cpu]";
 
 //-------------- prototypes section ------------------------------------
 
@@ -51,17 +77,31 @@ void check_fork(pid_t child);
 void kill_children(int sig);
 void do_child(const int pipe_dad_son[], const int pipe_son_dad[],
     int seed, int id);
+void parse_args(int argc, char* argv[]);
+int parse_cpu(const char* arg);
+void read_from_sons(int fd, int* value);
+void pin_to_cpu(int cpu);
+void prepare_channel(int fd);
+ssize_t read_channel(int fd, int* value);
+double elapsed_us(const struct timespec* t0, const struct timespec* t1);
+double cpu_seconds(const struct rusage* usage);
+void print_policy_report(int rounds, double total_round_us,
+    double min_round_us, double max_round_us);
 bool finish = false;
+enum wait_policy policy = BLOCK;
+int cpus[3] = { NO_CPU, NO_CPU, NO_CPU }; // dad, first son, second son
 
 //-------------- main --------------------------------------------------
 
 int main(int argc, char* argv[])
 {
-    if (argc != 2)
+    if (argc != 2 && argc != 3 && argc != 6)
     {
-        puts("Not enough arguments!");
+        puts("Wrong number of arguments!");
+        puts(USAGE);
         exit(EXIT_FAILURE);
     }
+    parse_args(argc, argv);
 
     // Using sigaction for signal
     struct sigaction act;
@@ -90,6 +130,8 @@ void do_child(const int pipe_dad_son[], const int pipe_sons_dad[],
 {
     close(pipe_sons_dad[0]); // can't read
     close(pipe_dad_son[1]); // can't write
+    pin_to_cpu(cpus[id + 1]);
+    prepare_channel(pipe_dad_son[0]);
     srand(seed + id);
 
     int zero_count = 0, minus_one_count = 0, one_count = 0, num_got = 0;
@@ -117,8 +159,7 @@ void do_child(const int pipe_dad_son[], const int pipe_sons_dad[],
         sigaddset(&block_mask, SIGUSR1);
         sigprocmask(SIG_BLOCK, &block_mask, NULL);
 
-        if (read(pipe_dad_son[0], &num_got, sizeof(num_got))
-            != sizeof(num_got))
+        if (read_channel(pipe_dad_son[0], &num_got) != sizeof(num_got))
         {
             perror("Invalid arguments! \n");
             exit(EXIT_FAILURE);
@@ -242,23 +283,18 @@ void do_dad(pid_t first_child, pid_t second_child,
     const int pipe_dad_second_son[])
 {
     int first_value = 0, second_value = 0, first_won = 0,
-        second_won = 0, first_result = 0, second_result = 0;
+        second_won = 0, first_result = 0, second_result = 0, rounds = 0;
+    double total_round_us = 0, min_round_us = 0, max_round_us = 0;
+    struct timespec t0, t1;
+
+    prepare_channel(pipe_sons_dad[0]);
     while (!finish)
     {
         first_result = 0, second_result = 0;
-        if (read(pipe_sons_dad[0], &first_value, sizeof(first_value))
-            != sizeof(first_value))
-        {
-            perror("Invalid arguments! \n");
-            exit(EXIT_FAILURE);
-        }
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        read_from_sons(pipe_sons_dad[0], &first_value);
 
-        if (read(pipe_sons_dad[0], &second_value, sizeof(second_value))
-            != sizeof(second_value))
-        {
-            perror("Invalid arguments! \n");
-            exit(EXIT_FAILURE);
-        }
+        read_from_sons(pipe_sons_dad[0], &second_value);
 
         // first_num - {0,..,9} second_num - {10,..., 19}
         // we want 10 to have leftover, so we need to add 1 to the value
@@ -302,6 +338,12 @@ void do_dad(pid_t first_child, pid_t second_child,
             perror("Invalid arguments! \n");
             exit(EXIT_FAILURE);
         }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        double round_us = elapsed_us(&t0, &t1);
+        total_round_us += round_us;
+        if (rounds == 0 || round_us < min_round_us) min_round_us = round_us;
+        if (round_us > max_round_us) max_round_us = round_us;
+        rounds++;
     }
 
     close(pipe_dad_second_son[1]);
@@ -311,6 +353,9 @@ void do_dad(pid_t first_child, pid_t second_child,
     int status;
     waitpid(first_child, &status, 0);
     waitpid(second_child, &status, 0);
+
+    print_policy_report(rounds, total_round_us, min_round_us,
+        max_round_us);
 }
 
 //----------------------------------------------------------------------
@@ -392,7 +437,242 @@ void create_pipes_and_run(int seed)
     close(pipe_dad_second_son[0]); // cant read
     close(pipe_dad_first_son[0]); // cant read
     close(pipe_sons_dad[1]); // cant write
+    pin_to_cpu(cpus[0]);
 
     do_dad(first_child, second_child, pipe_sons_dad,
         pipe_dad_first_son, pipe_dad_second_son);
 }
+
+//----------------------------------------------------------------------
+
+/* The function reads the optional arguments: the waiting policy and
+ *  the CPUs of the dad and the two sons.
+ * The function receives: the arguments of main.
+ * The function returns: void.
+ */
+void parse_args(int argc, char* argv[])
+{
+    if (argc >= 3)
+    {
+        if (strcmp(argv[2], POLICY_NAMES[SPIN]) == 0) policy = SPIN;
+        else if (strcmp(argv[2], POLICY_NAMES[HYBRID]) == 0)
+            policy = HYBRID;
+        else if (strcmp(argv[2], POLICY_NAMES[BLOCK]) != 0)
+        {
+            puts("Policy must be block, spin or hybrid!");
+            puts(USAGE);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc == 6)
+    {
+        for (int index = 0; index < 3; index++)
+        {
+            cpus[index] = parse_cpu(argv[index + 3]);
+        }
+    }
+}
+
+//----------------------------------------------------------------------
+
+/* The function reads a CPU number, and checks that this machine has it
+ *  and that this process may run on it.
+ * The function receives: the argument.
+ * The function returns: the CPU number.
+ */
+int parse_cpu(const char* arg)
+{
+    char* end;
+    long cpus_count = sysconf(_SC_NPROCESSORS_CONF);
+    errno = 0;
+    long cpu = strtol(arg, &end, 10);
+
+    if (errno != 0 || end == arg || *end != '\0' || cpu < 0 ||
+        cpu >= CPU_SETSIZE || (cpus_count > 0 && cpu >= cpus_count))
+    {
+        printf("Invalid cpu: %s (this machine has cpus 0-%ld)\n", arg,
+            cpus_count - 1);
+        puts(USAGE);
+        exit(EXIT_FAILURE);
+    }
+
+    // A cpuset or an offline cpu can forbid a cpu the machine has. A son
+    // that can't be pinned would leave the other son and the dad waiting
+    // for each other, so check it before any fork.
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+    {
+        perror("Can't get the allowed cpus");
+        exit(EXIT_FAILURE);
+    }
+    if (!CPU_ISSET(cpu, &allowed))
+    {
+        printf("Cpu %ld is not allowed for this process\n", cpu);
+        exit(EXIT_FAILURE);
+    }
+    return (int)cpu;
+}
+
+//----------------------------------------------------------------------
+
+/* The function reads a value that a son sent to the dad. If the sons
+ *  are gone (for example, one couldn't be pinned), the game stops.
+ * The function receives: the file descriptor and a pointer to the
+ *  value.
+ * The function returns: void.
+ */
+void read_from_sons(int fd, int* value)
+{
+    ssize_t got = read_channel(fd, value);
+    if (got == 0)
+    {
+        fputs("The children have stopped\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    if (got != sizeof(*value))
+    {
+        perror("Invalid arguments! \n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//----------------------------------------------------------------------
+
+/* The function pins the calling process to a single CPU, so the
+ *  scheduler won't migrate it between cores.
+ * The function receives: the CPU number, or NO_CPU to leave it free.
+ * The function returns: void.
+ */
+void pin_to_cpu(int cpu)
+{
+    if (cpu == NO_CPU)
+    {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == -1)
+    {
+        perror("Can't pin to cpu");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//----------------------------------------------------------------------
+
+/* The function makes the read side of a pipe non blocking when the
+ *  policy spins on it.
+ * The function receives: the file descriptor to read from.
+ * The function returns: void.
+ */
+void prepare_channel(int fd)
+{
+    if (policy == BLOCK)
+    {
+        return;
+    }
+
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1)
+    {
+        perror("Can't fcntl");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//----------------------------------------------------------------------
+
+/* The function reads one value from a pipe according to the policy:
+ *  block sleeps in read(), spin polls the pipe until data arrives, and
+ *  hybrid polls SPIN_LIMIT times before it sleeps in poll().
+ * The function receives: the file descriptor and a pointer to the
+ *  value.
+ * The function returns: the result of the read().
+ */
+ssize_t read_channel(int fd, int* value)
+{
+    if (policy == BLOCK)
+    {
+        return read(fd, value, sizeof(*value));
+    }
+
+    ssize_t got;
+    if (policy == SPIN)
+    {
+        while ((got = read(fd, value, sizeof(*value))) == -1 &&
+            errno == EAGAIN)
+        {
+        }
+        return got;
+    }
+
+    for (int spins = 0; spins < SPIN_LIMIT; spins++)
+    {
+        got = read(fd, value, sizeof(*value));
+        if (got != -1 || errno != EAGAIN)
+        {
+            return got;
+        }
+    }
+
+    struct pollfd wait_fd = { .fd = fd, .events = POLLIN };
+    while (poll(&wait_fd, 1, -1) == -1)
+    {
+        if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+    return read(fd, value, sizeof(*value));
+}
+
+//----------------------------------------------------------------------
+
+/* The function calculates the time between two moments.
+ * The function receives: two times.
+ * The function returns: the difference in microseconds.
+ */
+double elapsed_us(const struct timespec* t0, const struct timespec* t1)
+{
+    return (double)(t1->tv_sec - t0->tv_sec) * CORRECTION_NUMBER +
+        (double)(t1->tv_nsec - t0->tv_nsec) / NANO_IN_MICRO;
+}
+
+//----------------------------------------------------------------------
+
+/* The function sums the user and system time of a resource usage.
+ * The function receives: the resource usage.
+ * The function returns: the CPU time in seconds.
+ */
+double cpu_seconds(const struct rusage* usage)
+{
+    return (double)(usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) +
+        (double)(usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) /
+        CORRECTION_NUMBER;
+}
+
+//----------------------------------------------------------------------
+
+/* The function prints the average, shortest and longest round latency
+ *  and the CPU time used by the dad and the children under the chosen
+ *  policy.
+ * The function receives: the number of rounds, their total time, and
+ *  the shortest and longest round.
+ * The function returns: void.
+ */
+void print_policy_report(int rounds, double total_round_us,
+    double min_round_us, double max_round_us)
+{
+    struct rusage dad_usage, sons_usage;
+    getrusage(RUSAGE_SELF, &dad_usage);
+    getrusage(RUSAGE_CHILDREN, &sons_usage);
+
+    printf("Policy %s: %d rounds, %.3f us per round "
+        "(min %.3f us, max %.3f us)\n", POLICY_NAMES[policy], rounds,
+        rounds > 0 ? total_round_us / rounds : 0, min_round_us,
+        max_round_us);
+    printf("CPU time: dad %.4f s, children %.4f s\n",
+        cpu_seconds(&dad_usage), cpu_seconds(&sons_usage));
+}
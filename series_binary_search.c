@@ -8,11 +8,30 @@
  *  each search type, measures the time taken for each search, and
  *  writes the results (number of matches and time taken) to the
  *  father. The program runs multiple rounds
- *  and calculates overall search performance.
+ *  and calculates overall search performance. The father collects the
+ *  results of every round while the rounds run, and prints the
+ *  progress of the run.
  *
- * Input: An integer that represents the seed.
+ * The data can also be built once into a file (the unsorted values,
+ *  the sorted values and a sparse index of the sorted values), and
+ *  later runs map that file instead of generating the data again.
  *
- * Output: Run time of the series search, binary search and the main.
+ * In the update mode the data is generated once, and every next round
+ *  replaces only a percent of the values: each replacement deletes a
+ *  value and inserts a new one, so the size of the data stays fixed.
+ *  The sorted values are merged with the sorted changes instead of
+ *  being sorted again, and checked against a linear scan.
+ *
+ * Input: An integer that represents the seed, and optionally
+ *  "build <file> <number of values>", "map <file>" or
+ *  "update <percent of values>".
+ *
+ * Output: The times of every round and the rounds per second while the
+ *  run goes, then the run time of the series search, binary search and
+ *  the main. When the data is mapped, the searches run a different
+ *  number of queries, so the times are per query, with the cold and
+ *  warm cache times and the page faults of each search. In the update
+ *  mode, also the time of the updates.
  */
 
  //-------------- include section ---------------------------------------
@@ -22,8 +41,14 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 
 //-------------- const section -----------------------------------------
@@ -32,39 +57,148 @@ const int NUM_OF_ROUNDS = 10;
 const int VALUES_IN_ARR = 100000;
 const int NUM_OF_CHILDREN = 2;
 const int CORRECTION_NUMBER = 1000000;
+const int MAPPED_SERIES_QUERIES = 10; // every query scans the file
+const long INDEX_STRIDE = 1024; // values per index entry, a 4K page
+const long FILE_ALIGNMENT = 65536; // multiple of any page size
+const long DATASET_MAGIC = 0x5345415243484453; // "SEARCHDS"
+#define COLLECT_BUFFER 4096 // an array size, so not a const int
+const int COLLECT_TIMEOUT_MS = 100;
+const int CHECK_QUERIES = 1000;
+
+enum run_mode { IN_MEMORY, BUILD, MAP, UPDATE };
+
+//-------------- struct section ----------------------------------------
+
+// The data the children search in. In memory both arrays come from
+// malloc() and there is no index, when mapped all of them are in the file.
+struct dataset
+{
+    const int* series;
+    const int* sorted;
+    const int* index; // sorted[block * INDEX_STRIDE] of every block
+    long size;
+    long blocks;
+    long series_queries;
+};
+
+// The beginning of a dataset file. Offsets are from the file start.
+struct dataset_header
+{
+    long magic;
+    long size;
+    long blocks;
+    long series_offset;
+    long sorted_offset;
+    long index_offset;
+    long file_size;
+};
+
+// What the father collected from one kind of search.
+struct search_stats
+{
+    float total_time;
+    float cold_time;
+    float last_time;
+    long major_faults;
+    long minor_faults;
+    long queries; // in every round
+    int rounds;
+};
+
+// The results the father collected so far, and the bytes of the pipe
+// that are not a full line yet.
+struct collector
+{
+    int fd;
+    enum run_mode mode;
+    char buffer[COLLECT_BUFFER];
+    int length;
+    int received;
+    float update_time;
+    float build_time;
+    float total_update_time;
+    struct search_stats stats_s;
+    struct search_stats stats_b;
+    struct timeval start;
+};
 
 //-------------- prototypes section ------------------------------------
 
 void child_get_ready(const int pipe_sons_dad[]);
-void do_father(const int pipe_sons_dad[], float total_time_main);
-void do_father(const int pipe_sons_dad[], float total_time_main);
-void receive_time(float* total_time, int* counter);
+void do_father(const struct collector* col, float total_time_main,
+    enum run_mode mode);
+void receive_time(struct search_stats* stats, const char* line);
 void insertValuesInArrs(int binary_arr[], int series_arr[]);
 bool valid_fork(pid_t status);
 void sort(int arr[]);
 pid_t create_child();
-void binary_search(const int arr[], const int pipe_sons_dad[]);
-void series_search(const int arr[], const int pipe_sons_dad[]);
-void create_child_and_search(const int arr_s[], const int arr_b[],
-    const int pipe_sons_dad[]);
+void binary_search(const struct dataset* data, const int pipe_sons_dad[]);
+void series_search(const struct dataset* data, const int pipe_sons_dad[]);
+void create_child_and_search(const struct dataset* data,
+    const int pipe_sons_dad[], struct collector* col, int round);
 float get_total_time_and_wait(int is_binary);
 int compare(const void* a, const void* b);
+enum run_mode get_mode(int argc, char* argv[], long* number);
+long parse_count(const char* arg);
+long parse_updates(const char* arg);
+long align_up(long offset);
+void build_dataset(const char* path, long size);
+void map_dataset(const char* path, struct dataset* data);
+bool valid_header(const struct dataset_header* header, long real_size);
+void prefetch_index(const struct dataset* data);
+void print_search_result(char kind, unsigned int counter,
+    const struct timeval* t0, const struct rusage* usage0);
+void print_stats(const char* name, const struct search_stats* stats);
+void collect_round(struct collector* col, int round);
+void read_results(struct collector* col);
+void print_progress(const struct collector* col, int round);
+bool binary_find(const int arr[], long low, long high, int number);
+bool series_find(const int arr[], long size, int number);
+void update_arrays(int binary_arr[], int series_arr[], int updates);
+void check_search(const int binary_arr[], const int series_arr[]);
 
 //-------------- main --------------------------------------------------
 
 int main(int argc, char* argv[])
 {
-    if (argc != 2)
-    {
-        perror("Enter valid file name and a number/n");
-        exit(EXIT_FAILURE);
-    }
+    long number = 0;
+    enum run_mode mode = get_mode(argc, argv, &number);
 
     int seed = atoi(argv[1]);
     srand(seed);
 
-    int binary_arr[VALUES_IN_ARR], series_arr[VALUES_IN_ARR];
+    if (mode == BUILD)
+    {
+        build_dataset(argv[3], number);
+        exit(EXIT_SUCCESS);
+    }
+
+    int* binary_arr = NULL;
+    int* series_arr = NULL;
     float total_time_main = 0;
+    int updates = 0;
+    if (mode == UPDATE)
+    {
+        updates = number;
+    }
+
+    struct dataset data;
+    if (mode == MAP)
+    {
+        map_dataset(argv[3], &data);
+    }
+    else
+    {
+        binary_arr = malloc(VALUES_IN_ARR * sizeof(int));
+        series_arr = malloc(VALUES_IN_ARR * sizeof(int));
+        if (binary_arr == NULL || series_arr == NULL)
+        {
+            fputs("Can't allocate\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+        data = (struct dataset){ series_arr, binary_arr, NULL,
+            VALUES_IN_ARR, 0, VALUES_IN_ARR };
+    }
 
     int pipe_sons_dad[2];
     if (pipe(pipe_sons_dad) == -1)
@@ -73,15 +207,51 @@ int main(int argc, char* argv[])
         exit(EXIT_FAILURE);
     }
 
-    struct timeval t0, t1;
+    struct timeval t0, t1, u0, u1;
     gettimeofday(&t0, NULL);
 
+    struct collector col = { .fd = pipe_sons_dad[0], .start = t0,
+        .mode = mode };
+    col.stats_s.queries = data.series_queries;
+    col.stats_b.queries = VALUES_IN_ARR;
+
     for (int round = 0; round < NUM_OF_ROUNDS; round++)
     {
-        insertValuesInArrs(binary_arr, series_arr);
-        sort(binary_arr);
+        if (mode == IN_MEMORY)
+        {
+            insertValuesInArrs(binary_arr, series_arr);
+            sort(binary_arr);
+        }
+        else if (mode == UPDATE)
+        {
+            // the first round builds the arrays, the others update them
+            gettimeofday(&u0, NULL);
+            if (round == 0)
+            {
+                insertValuesInArrs(binary_arr, series_arr);
+                sort(binary_arr);
+            }
+            else
+            {
+                update_arrays(binary_arr, series_arr, updates);
+            }
+            gettimeofday(&u1, NULL);
+
+            col.update_time = (double)(u1.tv_usec - u0.tv_usec) /
+                CORRECTION_NUMBER + (double)(u1.tv_sec - u0.tv_sec);
+            col.total_update_time += col.update_time;
+            if (round == 0)
+            {
+                col.build_time = col.update_time;
+            }
+            check_search(binary_arr, series_arr);
+        }
 
-        create_child_and_search(series_arr, binary_arr, pipe_sons_dad);
+        create_child_and_search(&data, pipe_sons_dad, &col, round);
+        if (mode == MAP && round == 0)
+        {
+            prefetch_index(&data);
+        }
     }
 
     gettimeofday(&t1, NULL);
@@ -89,82 +259,270 @@ int main(int argc, char* argv[])
     total_time_main = (double)(t1.tv_usec - t0.tv_usec) /
         CORRECTION_NUMBER + (double)(t1.tv_sec - t0.tv_sec);
 
-    do_father(pipe_sons_dad, total_time_main);
+    close(pipe_sons_dad[0]);
+    close(pipe_sons_dad[1]);
+    do_father(&col, total_time_main, mode);
+    free(binary_arr);
+    free(series_arr);
 
     exit(EXIT_SUCCESS);
 }
 
 //----------------------------------------------------------------------
 
+/* The function checks the arguments and finds the mode of the run.
+ * The function receives: the arguments of main, and a pointer for the
+ *  number argument of the mode (the number of values to build, or the
+ *  number of values to replace in every round).
+ * The function returns: the mode of the run.
+ */
+enum run_mode get_mode(int argc, char* argv[], long* number)
+{
+    if (argc == 2)
+    {
+        return IN_MEMORY;
+    }
+    if (argc == 5 && strcmp(argv[2], "build") == 0 &&
+        (*number = parse_count(argv[4])) > 0)
+    {
+        return BUILD;
+    }
+    if (argc == 4 && strcmp(argv[2], "map") == 0)
+    {
+        return MAP;
+    }
+    if (argc == 4 && strcmp(argv[2], "update") == 0 &&
+        (*number = parse_updates(argv[3])) > 0)
+    {
+        return UPDATE;
+    }
+
+    fputs("Usage: series_binary_search <seed> [build <file> <values> | "
+        "map <file> | update <percent, at least one value>]\n", stderr);
+    exit(EXIT_FAILURE);
+}
+
+//----------------------------------------------------------------------
+
+/* The function reads a positive whole number, with nothing after it.
+ * The function receives: the argument.
+ * The function returns: the number, or -1 if it isn't valid.
+ */
+long parse_count(const char* arg)
+{
+    char* end;
+    errno = 0;
+    long count = strtol(arg, &end, 10);
+
+    if (errno != 0 || end == arg || *end != '\0' || count <= 0)
+    {
+        return -1;
+    }
+    return count;
+}
+
+//----------------------------------------------------------------------
+
+/* The function reads the percent of values to replace in every round,
+ *  which must be above 0 and at most 100.
+ * The function receives: the argument.
+ * The function returns: the number of values to replace, or 0 if the
+ *  percent isn't valid or replaces no value.
+ */
+long parse_updates(const char* arg)
+{
+    char* end;
+    errno = 0;
+    double percent = strtod(arg, &end);
+
+    // the comparisons are false for nan, so it is rejected too
+    if (errno != 0 || end == arg || *end != '\0' ||
+        !(percent > 0 && percent <= 100))
+    {
+        return 0;
+    }
+    return (long)(VALUES_IN_ARR * percent / 100);
+}
+
+//----------------------------------------------------------------------
+
 /* The function creates a child process and performs a search based on
- *  the input flag.
- * The function receives: an array of integers, a file pointer,
- *  a pointer to a double, and an integer.
+ *  the input flag, and collects the results of the round.
+ * The function receives: the data to search in, a pipe, the collector
+ *  and the number of the round.
  * The function returns: void.
  */
-void create_child_and_search(const int arr_s[], const int arr_b[],
-    const int pipe_sons_dad[])
+void create_child_and_search(const struct dataset* data,
+    const int pipe_sons_dad[], struct collector* col, int round)
 {
     pid_t series_child = create_child();
     if (series_child == 0)
     {
         child_get_ready(pipe_sons_dad);
-        series_search(arr_s, pipe_sons_dad);
+        series_search(data, pipe_sons_dad);
     }
 
     pid_t binary_child = create_child();
     if (binary_child == 0)
     {
         child_get_ready(pipe_sons_dad);
-        binary_search(arr_b, pipe_sons_dad);
+        binary_search(data, pipe_sons_dad);
+    }
+    collect_round(col, round);
+}
+
+//----------------------------------------------------------------------
+
+/* The function reads the results of a round from the pipe as soon as
+ *  they arrive, so the pipe never fills up, and waits for the children.
+ *  If both children are gone and a result is still missing, the run
+ *  stops.
+ * The function receives: the collector and the number of the round.
+ * The function returns: void.
+ */
+void collect_round(struct collector* col, int round)
+{
+    int wanted = (round + 1) * NUM_OF_CHILDREN, exited = 0;
+    struct pollfd pipe_fd = { .fd = col->fd, .events = POLLIN };
+
+    while (col->received < wanted)
+    {
+        if (poll(&pipe_fd, 1, COLLECT_TIMEOUT_MS) > 0)
+        {
+            read_results(col);
+        }
+        else if (exited == NUM_OF_CHILDREN)
+        {
+            fputs("A child didn't send its result\n", stderr);
+            exit(EXIT_FAILURE);
+        }
+
+        while (exited < NUM_OF_CHILDREN && waitpid(-1, NULL, WNOHANG) > 0)
+        {
+            exited++;
+        }
+    }
+
+    for (; exited < NUM_OF_CHILDREN; exited++)
+    {
+        wait(NULL);
+    }
+    print_progress(col, round);
+}
+
+//----------------------------------------------------------------------
+
+/* The function reads what is waiting in the pipe and updates the stats
+ *  for every full line.
+ * The function receives: the collector.
+ * The function returns: void.
+ */
+void read_results(struct collector* col)
+{
+    ssize_t got = read(col->fd, col->buffer + col->length,
+        COLLECT_BUFFER - 1 - col->length);
+    if (got <= 0)
+    {
+        perror("Can't read \n");
+        exit(EXIT_FAILURE);
+    }
+    col->length += got;
+    col->buffer[col->length] = '\0';
+
+    char* line = col->buffer;
+    char* end;
+    while ((end = strchr(line, '\n')) != NULL)
+    {
+        *end = '\0';
+        if (line[0] == 'b')
+        {
+            receive_time(&col->stats_b, line + 1);
+            col->received++;
+        }
+        else if (line[0] == 's')
+        {
+            receive_time(&col->stats_s, line + 1);
+            col->received++;
+        }
+        line = end + 1;
     }
-    wait(NULL);
-    wait(NULL);
+
+    col->length -= line - col->buffer;
+    memmove(col->buffer, line, col->length);
+}
+
+//----------------------------------------------------------------------
+
+/* The function prints the results of the last round and the
+ *  throughput of the run so far. In the update mode, also the time the
+ *  round spent on building or updating the arrays.
+ * The function receives: the collector and the number of the round.
+ * The function returns: void.
+ */
+void print_progress(const struct collector* col, int round)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    double elapsed = (double)(now.tv_usec - col->start.tv_usec) /
+        CORRECTION_NUMBER + (double)(now.tv_sec - col->start.tv_sec);
+
+    printf("round %d/%d: ", round + 1, NUM_OF_ROUNDS);
+    if (col->mode == UPDATE)
+    {
+        printf("%s %.4f ", round == 0 ? "build" : "update",
+            col->update_time);
+    }
+    printf("s %.4f b %.4f, %.2f rounds/s\n", col->stats_s.last_time,
+        col->stats_b.last_time, (round + 1) / elapsed);
+    fflush(stdout);
 }
 
 //----------------------------------------------------------------------
 
 /* The function performs a binary search on an array and writes results
- *  to the stdout, which goes to the father.
- * The function receives: an array of integers and pipe.
+ *  to the stdout, which goes to the father. When the data has an
+ *  index, the index chooses the block first, so only one block of the
+ *  sorted values is touched.
+ * The function receives: the data to search in and pipe.
  * The function returns: void.
  */
-void binary_search(const int arr[], const int pipe_sons_dad[])
+void binary_search(const struct dataset* data, const int pipe_sons_dad[])
 {
-    struct timeval t0, t1;
+    struct timeval t0;
+    struct rusage usage0;
     gettimeofday(&t0, NULL);
+    getrusage(RUSAGE_SELF, &usage0);
 
     srand(time(NULL));
     unsigned int counter = 0;
-    float t_time = 0;
 
     for (int round = 0; round < VALUES_IN_ARR; round++)
     {
 
-        int low = 0, high = VALUES_IN_ARR - 1;
+        long low = 0, high = data->size - 1;
 
-        int random_number = rand() % (VALUES_IN_ARR * NUM_OF_ROUNDS);
+        int random_number = rand() % (data->size * NUM_OF_ROUNDS);
 
-        while (low < high)
+        if (data->index != NULL)
         {
-            int mid = (low + high) / 2;
-            if (random_number == arr[mid])
+            long first = 0, last = data->blocks - 1;
+            while (first < last) // last block that starts <= the number
             {
-                counter++;
-                break;
+                long mid = (first + last + 1) / 2;
+                if (data->index[mid] <= random_number) first = mid;
+                else last = mid - 1;
             }
-            else if (random_number < arr[mid]) high = mid - 1;
-            else low = mid + 1;
+            low = first * INDEX_STRIDE;
+            if (low + INDEX_STRIDE - 1 < high) high = low + INDEX_STRIDE - 1;
         }
 
+        if (binary_find(data->sorted, low, high, random_number))
+        {
+            counter++;
+        }
     }
 
-    gettimeofday(&t1, NULL);
-
-    t_time = (double)(t1.tv_usec - t0.tv_usec) / CORRECTION_NUMBER +
-        (double)(t1.tv_sec - t0.tv_sec);
-
-    printf("b %u %f ", counter, t_time);
+    print_search_result('b', counter, &t0, &usage0);
 
     close(pipe_sons_dad[1]);
     exit(EXIT_SUCCESS);
@@ -174,37 +532,30 @@ void binary_search(const int arr[], const int pipe_sons_dad[])
 
 /* The function performs a linear search on an array and writes results
  *  to the stdout, which is the father.
- * The function receives: an array of integers and pipe.
+ * The function receives: the data to search in and pipe.
  * The function returns: void.
  */
-void series_search(const int arr[], const int pipe_sons_dad[])
+void series_search(const struct dataset* data, const int pipe_sons_dad[])
 {
-    struct timeval t0, t1;
+    struct timeval t0;
+    struct rusage usage0;
     gettimeofday(&t0, NULL);
+    getrusage(RUSAGE_SELF, &usage0);
 
     srand(time(NULL));
     unsigned int counter = 0;
-    float t_time = 0;
 
-    for (int round = 0; round < VALUES_IN_ARR; round++)
+    for (long round = 0; round < data->series_queries; round++)
     {
-        int random_number = rand() % (VALUES_IN_ARR * NUM_OF_ROUNDS);
+        int random_number = rand() % (data->size * NUM_OF_ROUNDS);
 
-        for (int index = 0; index < VALUES_IN_ARR; index++)
+        if (series_find(data->series, data->size, random_number))
         {
-            if (arr[index] == random_number)
-            {
-                counter++;
-                break;
-            }
+            counter++;
         }
     }
-    gettimeofday(&t1, NULL);
 
-    t_time = (double)(t1.tv_usec - t0.tv_usec) / CORRECTION_NUMBER +
-        (double)(t1.tv_sec - t0.tv_sec);
-
-    printf("s %u %f ", counter, t_time);
+    print_search_result('s', counter, &t0, &usage0);
 
     close(pipe_sons_dad[1]);
     exit(EXIT_SUCCESS);
@@ -212,6 +563,65 @@ void series_search(const int arr[], const int pipe_sons_dad[])
 
 //----------------------------------------------------------------------
 
+/* The function looks for a number in a part of a sorted array.
+ * The function receives: the array, the first and last index of the
+ *  part, and the number.
+ * The function returns: true if the number is in the part.
+ */
+bool binary_find(const int arr[], long low, long high, int number)
+{
+    while (low <= high)
+    {
+        long mid = (low + high) / 2;
+        if (number == arr[mid]) return true;
+        else if (number < arr[mid]) high = mid - 1;
+        else low = mid + 1;
+    }
+    return false;
+}
+
+//----------------------------------------------------------------------
+
+/* The function looks for a number in an array, one value after the
+ *  other.
+ * The function receives: the array, its size, and the number.
+ * The function returns: true if the number is in the array.
+ */
+bool series_find(const int arr[], long size, int number)
+{
+    for (long index = 0; index < size; index++)
+    {
+        if (arr[index] == number) return true;
+    }
+    return false;
+}
+
+//----------------------------------------------------------------------
+
+/* The function writes the result of a search to the stdout, which goes
+ *  to the father: the kind, the matches, the time and the page faults.
+ * The function receives: the kind of the search, the matches, and the
+ *  time and resource usage from the start of the search.
+ * The function returns: void.
+ */
+void print_search_result(char kind, unsigned int counter,
+    const struct timeval* t0, const struct rusage* usage0)
+{
+    struct timeval t1;
+    struct rusage usage1;
+    gettimeofday(&t1, NULL);
+    getrusage(RUSAGE_SELF, &usage1);
+
+    float t_time = (double)(t1.tv_usec - t0->tv_usec) / CORRECTION_NUMBER
+        + (double)(t1.tv_sec - t0->tv_sec);
+
+    printf("%c %u %f %ld %ld\n", kind, counter, t_time,
+        usage1.ru_majflt - usage0->ru_majflt,
+        usage1.ru_minflt - usage0->ru_minflt);
+}
+
+//----------------------------------------------------------------------
+
 /* The function creates a child process.
  * The function receives: no parameters.
  * The function returns: a process ID (pid_t).
@@ -281,50 +691,356 @@ void insertValuesInArrs(int binary_arr[], int series_arr[])
 
 //----------------------------------------------------------------------
 
-/* The function reads from the stdout, and updated the values.
- * The function receives: 2 intereges by pointers.
+/* The function replaces random values of the arrays with new random
+ *  values. Only the changes are sorted, and then the sorted array, the
+ *  new values and the removed values are merged in one pass, instead
+ *  of sorting the whole array again.
+ * The function receives: 2 arrays of integers and the number of values
+ *  to replace.
  * The function returns: void.
  */
-void receive_time(float* total_time, int* counter)
+void update_arrays(int binary_arr[], int series_arr[], int updates)
 {
-    float time;
-    scanf("%f", &time);
-    scanf("%f", &time);
-    (*total_time) += time;
-    (*counter)++;
+    int* removed = malloc(updates * sizeof(int));
+    int* added = malloc(updates * sizeof(int));
+    int* merged = malloc(VALUES_IN_ARR * sizeof(int));
+    if (removed == NULL || added == NULL || merged == NULL)
+    {
+        fputs("Can't allocate\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int update = 0; update < updates; update++)
+    {
+        int index = rand() % VALUES_IN_ARR;
+        removed[update] = series_arr[index];
+        added[update] = rand() % (VALUES_IN_ARR + 1);
+        series_arr[index] = added[update];
+    }
+    qsort(removed, updates, sizeof(int), compare);
+    qsort(added, updates, sizeof(int), compare);
+
+    // Every removed value is in the old or the added values, so it is
+    // met in the merge, and one copy of it is skipped.
+    int old = 0, new = 0, gone = 0, out = 0;
+    while (old < VALUES_IN_ARR || new < updates)
+    {
+        int value;
+        if (new == updates ||
+            (old < VALUES_IN_ARR && binary_arr[old] <= added[new]))
+        {
+            value = binary_arr[old++];
+        }
+        else
+        {
+            value = added[new++];
+        }
+
+        if (gone < updates && removed[gone] == value) gone++;
+        else merged[out++] = value;
+    }
+    memcpy(binary_arr, merged, VALUES_IN_ARR * sizeof(int));
+
+    free(removed);
+    free(added);
+    free(merged);
 }
 
 //----------------------------------------------------------------------
 
-/* The function recieves the information from the children, and prints
- *  them.
- * The function receives: A pipe and a float value.
+/* The function checks that the binary search on the sorted array finds
+ *  the same numbers as a linear scan of the series array.
+ * The function receives: 2 arrays of integers.
  * The function returns: void.
  */
-void do_father(const int pipe_sons_dad[], float total_time_main)
+void check_search(const int binary_arr[], const int series_arr[])
 {
-    dup2(pipe_sons_dad[0], STDIN_FILENO); // writes to stdout
-    close(pipe_sons_dad[0]);
-    close(pipe_sons_dad[1]);
-
-    float total_time_s = 0, total_time_b = 0;
-    char c;
-    for (int counter = 0; counter < NUM_OF_ROUNDS * NUM_OF_CHILDREN;)
+    for (int query = 0; query < CHECK_QUERIES; query++)
     {
-        scanf("%c", &c);
-        if (c == 'b')
-        {
-            receive_time(&total_time_b, &counter);
-        }
-        else if (c == 's')
+        int random_number = rand() % (VALUES_IN_ARR + 1);
+        if (binary_find(binary_arr, 0, VALUES_IN_ARR - 1, random_number)
+            != series_find(series_arr, VALUES_IN_ARR, random_number))
         {
-            receive_time(&total_time_s, &counter);
+            fputs("The sorted array doesn't match the series array\n",
+                stderr);
+            exit(EXIT_FAILURE);
         }
     }
+}
 
-    printf("%.4f %.4f \n%.4f\n", (total_time_s / NUM_OF_ROUNDS),
-        (total_time_b / NUM_OF_ROUNDS), total_time_main);
-    close(pipe_sons_dad[0]);
+//----------------------------------------------------------------------
+
+/* The function rounds an offset up to the file alignment, so every
+ *  part of the file starts on a page.
+ * The function receives: an offset.
+ * The function returns: the aligned offset.
+ */
+long align_up(long offset)
+{
+    return (offset + FILE_ALIGNMENT - 1) / FILE_ALIGNMENT * FILE_ALIGNMENT;
+}
+
+//----------------------------------------------------------------------
+
+/* The function builds a dataset file: random values, the same values
+ *  sorted, and an index of the first sorted value of every block. The
+ *  file is mapped while it is built, so it may be larger than the RAM.
+ * The function receives: the path of the file and the number of values.
+ * The function returns: void.
+ */
+void build_dataset(const char* path, long size)
+{
+    struct dataset_header header;
+    header.magic = DATASET_MAGIC;
+    header.size = size;
+    header.blocks = (size + INDEX_STRIDE - 1) / INDEX_STRIDE;
+    header.series_offset = align_up(sizeof(header));
+    header.sorted_offset = align_up(header.series_offset +
+        size * sizeof(int));
+    header.index_offset = align_up(header.sorted_offset +
+        size * sizeof(int));
+    header.file_size = header.index_offset + header.blocks * sizeof(int);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1 || ftruncate(fd, header.file_size) == -1)
+    {
+        perror("Can't create the file");
+        exit(EXIT_FAILURE);
+    }
+
+    char* base = mmap(NULL, header.file_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        perror("Can't mmap");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    int* series = (int*)(base + header.series_offset);
+    int* sorted = (int*)(base + header.sorted_offset);
+    int* index = (int*)(base + header.index_offset);
+
+    for (long value = 0; value < size; value++)
+    {
+        series[value] = rand() % (size + 1);
+    }
+    memcpy(sorted, series, size * sizeof(int));
+    qsort(sorted, size, sizeof(int), compare);
+
+    for (long block = 0; block < header.blocks; block++)
+    {
+        index[block] = sorted[block * INDEX_STRIDE];
+    }
+    memcpy(base, &header, sizeof(header));
+
+    if (msync(base, header.file_size, MS_SYNC) == -1)
+    {
+        perror("Can't msync");
+        exit(EXIT_FAILURE);
+    }
+    munmap(base, header.file_size);
+
+    printf("Built %ld values in %s\n", size, path);
+}
+
+//----------------------------------------------------------------------
+
+/* The function maps a dataset file read only. The file is dropped from
+ *  the page cache first, so the first round runs on a cold cache, index
+ *  included. The series part is scanned in order and the sorted part is
+ *  accessed at random.
+ * The function receives: the path of the file and the data to fill.
+ * The function returns: void.
+ */
+void map_dataset(const char* path, struct dataset* data)
+{
+    struct dataset_header header;
+    struct stat file_stat;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &file_stat) == -1 ||
+        read(fd, &header, sizeof(header)) == -1)
+    {
+        perror("Can't read the file");
+        exit(EXIT_FAILURE);
+    }
+    if (!valid_header(&header, file_stat.st_size))
+    {
+        fputs("The file is not a valid dataset\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    int error = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    if (error != 0)
+    {
+        fprintf(stderr, "Can't drop the cache: %s\n", strerror(error));
+        exit(EXIT_FAILURE);
+    }
+
+    char* base = mmap(NULL, header.file_size, PROT_READ, MAP_SHARED,
+        fd, 0);
+    if (base == MAP_FAILED)
+    {
+        perror("Can't mmap");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    if (madvise(base + header.series_offset, header.size * sizeof(int),
+        MADV_SEQUENTIAL) == -1 ||
+        madvise(base + header.sorted_offset, header.size * sizeof(int),
+        MADV_RANDOM) == -1)
+    {
+        perror("Can't madvise");
+        exit(EXIT_FAILURE);
+    }
+
+    data->series = (const int*)(base + header.series_offset);
+    data->sorted = (const int*)(base + header.sorted_offset);
+    data->index = (const int*)(base + header.index_offset);
+    data->size = header.size;
+    data->blocks = header.blocks;
+    data->series_queries = MAPPED_SERIES_QUERIES;
+}
+
+//----------------------------------------------------------------------
+
+/* The function checks that a header was written by build_dataset(), and
+ *  that every part it describes is inside the file.
+ * The function receives: the header and the real size of the file.
+ * The function returns: true if the header can be trusted.
+ */
+bool valid_header(const struct dataset_header* header, long real_size)
+{
+    if (real_size < (long)sizeof(*header) ||
+        header->magic != DATASET_MAGIC || header->size <= 0 ||
+        header->size > real_size / (long)sizeof(int) ||
+        header->file_size > real_size)
+    {
+        return false;
+    }
+
+    long values_size = header->size * sizeof(int);
+    long index_size = header->blocks * sizeof(int);
+
+    return header->blocks ==
+        (header->size + INDEX_STRIDE - 1) / INDEX_STRIDE &&
+        header->series_offset % FILE_ALIGNMENT == 0 &&
+        header->sorted_offset % FILE_ALIGNMENT == 0 &&
+        header->index_offset % FILE_ALIGNMENT == 0 &&
+        header->series_offset >= (long)sizeof(*header) &&
+        header->series_offset <= header->file_size &&
+        header->sorted_offset <= header->file_size &&
+        header->sorted_offset >= header->series_offset + values_size &&
+        header->index_offset >= header->sorted_offset + values_size &&
+        header->index_offset <= header->file_size - index_size;
+}
+
+//----------------------------------------------------------------------
+
+/* The function asks the kernel to read the whole index, which every
+ *  query needs. It is called after the cold round, so the cold times
+ *  include reading the index from the disk.
+ * The function receives: the mapped data.
+ * The function returns: void.
+ */
+void prefetch_index(const struct dataset* data)
+{
+    if (madvise((void*)data->index, data->blocks * sizeof(int),
+        MADV_WILLNEED) == -1)
+    {
+        perror("Can't madvise");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//----------------------------------------------------------------------
+
+/* The function reads a result line of a child, and updated the values.
+ * The function receives: the stats of the search by pointer, and the
+ *  line without its kind.
+ * The function returns: void.
+ */
+void receive_time(struct search_stats* stats, const char* line)
+{
+    unsigned int found;
+    float time;
+    long major_faults, minor_faults;
+    if (sscanf(line, "%u %f %ld %ld", &found, &time, &major_faults,
+        &minor_faults) != 4)
+    {
+        fputs("Invalid result from a child\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    stats->last_time = time;
+    if (stats->rounds == 0)
+    {
+        stats->cold_time = time;
+    }
+    stats->total_time += time;
+    stats->major_faults += major_faults;
+    stats->minor_faults += minor_faults;
+    stats->rounds++;
+}
+
+//----------------------------------------------------------------------
+
+/* The function prints the cold cache time (the first round) and the
+ *  average warm cache time (the other rounds), per round and per query,
+ *  and the page faults of one kind of search.
+ * The function receives: the name of the search and its stats.
+ * The function returns: void.
+ */
+void print_stats(const char* name, const struct search_stats* stats)
+{
+    float warm_time = 0;
+    if (stats->rounds > 1)
+    {
+        warm_time = (stats->total_time - stats->cold_time) /
+            (stats->rounds - 1);
+    }
+    printf("%s: %ld queries per round, cold %.4f (%.3f us per query) "
+        "warm %.4f (%.3f us per query) faults %ld major %ld minor\n", name,
+        stats->queries, stats->cold_time,
+        stats->cold_time * CORRECTION_NUMBER / stats->queries, warm_time,
+        warm_time * CORRECTION_NUMBER / stats->queries,
+        stats->major_faults, stats->minor_faults);
+}
+
+//----------------------------------------------------------------------
+
+/* The function prints the information the father collected from the
+ *  children.
+ * The function receives: the collector, a float value, and the mode of
+ *  the run.
+ * The function returns: void.
+ */
+void do_father(const struct collector* col, float total_time_main,
+    enum run_mode mode)
+{
+    if (mode == MAP)
+    {
+        // the searches run a different number of queries, so only the
+        // time of one query can be compared
+        printf("%.3f %.3f us per query\n%.4f\n",
+            col->stats_s.total_time * CORRECTION_NUMBER /
+            (NUM_OF_ROUNDS * col->stats_s.queries),
+            col->stats_b.total_time * CORRECTION_NUMBER /
+            (NUM_OF_ROUNDS * col->stats_b.queries), total_time_main);
+        print_stats("series", &col->stats_s);
+        print_stats("binary", &col->stats_b);
+        return;
+    }
+
+    printf("%.4f %.4f \n%.4f\n", (col->stats_s.total_time / NUM_OF_ROUNDS),
+        (col->stats_b.total_time / NUM_OF_ROUNDS), total_time_main);
+    if (mode == UPDATE)
+    {
+        // the first round builds the arrays, the others only update them
+        printf("update: build %.4f incremental %.4f\n",
+            col->build_time, (col->total_update_time - col->build_time) /
+            (NUM_OF_ROUNDS - 1));
+    }
 }
 
 //----------------------------------------------------------------------